@@ -6,6 +6,8 @@
 #define FS_H
 
 #include <iostream>
+#include <fstream>
+#include <cstdio> // rename()/remove() para segmentos y desborde
 using namespace std;
 
 // Tipos de nodo
@@ -26,6 +28,22 @@ struct Nodo {
     Nodo* siguienteHermano;
     // Solo para archivos
     Linea* primeraLinea;
+    // Seguimiento de cambios para el guardado por segmentos
+    unsigned id;          // identificador estable (nombre de su segmento)
+    unsigned version;     // se incrementa en cada modificación
+    bool sucio;           // su segmento debe reescribirse (nombres/miembros o contenido)
+    bool subarbolSucio;   // algún descendiente está sucio
+    unsigned segmento;    // generación de su segmento vigente en disco (0 = ninguno)
+    // Presupuesto de memoria (solo archivos)
+    bool desalojado;            // contenido en el archivo de desborde, primeraLinea == nullptr
+    long long desbordeOffset;   // posición del contenido en el desborde (-1 si nunca se escribió)
+    int desbordeLineas;
+    long long desbordeBytes;    // bytes del contenido copiado
+    long long desbordeCapacidad;// tamaño del hueco reservado (se reutiliza si cabe)
+    unsigned versionDesborde;   // version del contenido copiado al desborde
+    long long bytesResidentes;  // bytes contabilizados mientras está en memoria
+    Nodo* lruAnterior;          // más reciente (LRU o lista de desalojados)
+    Nodo* lruSiguiente;         // menos reciente
 };
 
 // ---- Utilidades de cadenas (sin <cstring>) ----
@@ -43,6 +61,23 @@ Nodo* buscar_hijo(Nodo* dir, const char* nombre);
 bool tiene_hijo_llamado(Nodo* dir, const char* nombre);
 void enlazar_hijo_al_frente(Nodo* padre, Nodo* hijo);
 void desvincular_de_padre(Nodo* n); // quita n de la lista de hijos de su padre
+// Marca n como modificado (su segmento debe reescribirse) y marca
+// subarbolSucio en sus ancestros
+void marcar_sucio(Nodo* n);
+
+// ---- Presupuesto de memoria ----
+// Con presupuesto > 0, el contenido de los archivos menos usados (LRU) se
+// desaloja a un archivo de desborde y se recupera al accederlo. 0 = sin límite.
+// El desborde se llama "<base>.swp" (o "<base>.<k>.swp" si ya existe).
+// Si no se puede abrir, no se desaloja e imprimir_estado_memoria lo informa.
+void configurar_memoria(long long presupuesto, const char* baseDesborde);
+// Trae el contenido de f a memoria si estaba desalojado (cuenta acierto/fallo)
+bool asegurar_residente(Nodo* f);
+// Recalcula los bytes de f tras modificarlo y aplica el presupuesto
+void contabilizar_archivo(Nodo* f);
+void imprimir_estado_memoria(ostream& out);
+// Cierra y elimina el archivo de desborde
+void cerrar_memoria();
 
 // ---- Operaciones del sistema de archivos ----
 Nodo* crear_directorio(Nodo* cwd, const char* nombre, ostream& out);
@@ -72,6 +107,30 @@ bool editar_archivo(Nodo* f, istream& in, ostream& out);
 bool serializar_arbol(Nodo* raiz, ostream& out);
 bool deserializar_arbol(Nodo* raiz, istream& in, ostream& out);
 
+// ---- Persistencia por segmentos ----
+// Cada directorio y cada archivo se guarda en su propio segmento "<base>.<id>.<gen>.seg".
+// Directorio:              Archivo:
+// V <id> <version>         V <id> <version> <N>
+// D <id> <gen> <nombre>    <N líneas de contenido>
+// F <id> <gen> <nombre>    E
+// E
+// La línea "E" marca el fin; un segmento sin ella se considera truncado.
+// El manifiesto "<base>.man" contiene "M <idRaiz> <genRaiz> <siguienteId> <generacion> <huellaTexto>".
+// Un guardado escribe los segmentos sucios y sus ancestros con nombres nuevos;
+// el rename del manifiesto lo confirma y solo entonces se borran los reemplazados.
+bool guardar_segmentos(Nodo* raiz, const char* base, ostream& out);
+// Guarda los segmentos y escribe la exportación de texto completa en 'base'
+// con la línea "G <generacion>"; el manifiesto guarda la huella de ese texto
+bool exportar_texto(Nodo* raiz, const char* base, ostream& out);
+// true si el manifiesto es más nuevo que el texto, o de la misma generación
+// y el texto no se modificó desde que se exportó. Un texto sin "G" siempre gana
+bool segmentos_vigentes(const char* base);
+// Carga el árbol (raíz vacía) desde el manifiesto; false si no existe o es inconsistente
+bool cargar_segmentos(Nodo* raiz, const char* base, ostream& out);
+// Antes de cargar 'base' desde el texto: evita reutilizar ids de sus segmentos
+// y los elimina tras el próximo manifiesto
+void descartar_segmentos(Nodo* raiz, const char* base);
+
 // ---- Helper de IO ----
 // getline seguro en un buffer nuevo (límite maxLen). Devuelve nullptr en EOF.
 char* leer_linea_alloc(istream& in, int maxLen);
@@ -106,6 +165,9 @@ int str_comparar(const char* a, const char* b) {
     return a[i] ? 1 : -1;
 }
 
+static unsigned siguiente_id_nodo = 1;
+static unsigned generacion_guardado = 0; // aumenta con cada manifiesto escrito
+
 char* str_duplicar(const char* s) {
     int n = str_longitud(s);
     char* r = new char[n + 1];
@@ -130,9 +192,331 @@ Nodo* crear_nodo(TipoNodo t, const char* nombre, Nodo* padre) {
     n->primerHijo = nullptr;
     n->siguienteHermano = nullptr;
     n->primeraLinea = nullptr;
+    n->id = siguiente_id_nodo++;
+    n->version = 1;
+    n->sucio = true;
+    n->subarbolSucio = false;
+    n->segmento = 0;
+    n->desalojado = false;
+    n->desbordeOffset = -1;
+    n->desbordeLineas = 0;
+    n->desbordeBytes = 0;
+    n->desbordeCapacidad = 0;
+    n->versionDesborde = 0;
+    n->bytesResidentes = 0;
+    n->lruAnterior = nullptr;
+    n->lruSiguiente = nullptr;
     return n;
 }
 
+static char* ruta_con_sufijo(const char* base, unsigned id, bool conId, const char* sufijo) {
+    // "<base>.<id><sufijo>" o "<base><sufijo>"
+    char digitos[16]; int nd = 0;
+    if (conId) {
+        char inv[16]; int ni = 0;
+        do { inv[ni++] = (char)('0' + id % 10); id /= 10; } while (id > 0);
+        digitos[nd++] = '.';
+        while (ni > 0) digitos[nd++] = inv[--ni];
+    }
+    digitos[nd] = '\0';
+    int lb = str_longitud(base), ls = str_longitud(sufijo);
+    char* r = new char[lb + nd + ls + 1];
+    int pos = 0;
+    for (int k = 0; k < lb; ++k) r[pos++] = base[k];
+    for (int k = 0; k < nd; ++k) r[pos++] = digitos[k];
+    for (int k = 0; k < ls; ++k) r[pos++] = sufijo[k];
+    r[pos] = '\0';
+    return r;
+}
+
+// ---- Presupuesto de memoria ----
+
+struct EstadoMemoria {
+    long long presupuesto;   // 0 = sin límite
+    long long bytesVivos;    // contenido residente de todos los archivos
+    unsigned long aciertos;  // accesos con el contenido en memoria
+    unsigned long fallos;    // accesos que leyeron del desborde
+    unsigned long desalojos;
+    unsigned long compactaciones;
+    long long bytesDesborde; // capacidad de los huecos en uso
+    long long bytesMuertos;  // huecos abandonados; se compacta al superar a los usados
+    Nodo* lruPrimero;        // residentes
+    Nodo* lruUltimo;
+    Nodo* desalojadosPrimero;// todo nodo con hueco está en una de las dos listas
+    Nodo* desalojadosUltimo;
+    fstream* desborde;
+    char* baseDesborde;      // base de persistencia de la que se deriva el nombre
+    char* rutaDesborde;      // archivo en uso, elegido al abrirlo
+    bool desbordeFallido;    // no se pudo abrir: no se desaloja hasta reconfigurar
+};
+
+static EstadoMemoria memoria_fs = { 0, 0, 0, 0, 0, 0, 0, 0, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, false };
+
+static long long bytes_de_lineas(Linea* l) {
+    long long b = 0;
+    while (l) { b += (long long)sizeof(Linea) + str_longitud(l->texto) + 1; l = l->siguiente; }
+    return b;
+}
+
+static void lista_quitar(Nodo*& primero, Nodo*& ultimo, Nodo* f) {
+    if (f->lruAnterior) f->lruAnterior->lruSiguiente = f->lruSiguiente;
+    else if (primero == f) primero = f->lruSiguiente;
+    if (f->lruSiguiente) f->lruSiguiente->lruAnterior = f->lruAnterior;
+    else if (ultimo == f) ultimo = f->lruAnterior;
+    f->lruAnterior = nullptr; f->lruSiguiente = nullptr;
+}
+
+static void lista_al_frente(Nodo*& primero, Nodo*& ultimo, Nodo* f) {
+    if (primero == f) return;
+    lista_quitar(primero, ultimo, f);
+    f->lruSiguiente = primero;
+    if (primero) primero->lruAnterior = f;
+    primero = f;
+    if (!ultimo) ultimo = f;
+}
+
+static void quitar_de_lru(Nodo* f) { lista_quitar(memoria_fs.lruPrimero, memoria_fs.lruUltimo, f); }
+static void poner_al_frente_lru(Nodo* f) { lista_al_frente(memoria_fs.lruPrimero, memoria_fs.lruUltimo, f); }
+
+static void liberar_hueco_desborde(Nodo* f) {
+    if (f->desbordeOffset < 0) return;
+    memoria_fs.bytesDesborde -= f->desbordeCapacidad;
+    memoria_fs.bytesMuertos += f->desbordeCapacidad;
+    f->desbordeOffset = -1;
+    f->desbordeCapacidad = 0;
+    f->desbordeBytes = 0;
+    f->desbordeLineas = 0;
+}
+
+static char* ruta_desborde_libre(const char* base) {
+    // "<base>.swp", o "<base>.<k>.swp" si otra instancia ya usa ese nombre
+    for (unsigned k = 0; k < 1000; ++k) {
+        char* r = ruta_con_sufijo(base, k, k > 0, ".swp");
+        ifstream prueba(r, ios::in | ios::binary);
+        if (!prueba.is_open()) return r;
+        delete[] r;
+    }
+    return nullptr;
+}
+
+static bool abrir_desborde() {
+    if (memoria_fs.desborde) return true;
+    if (!memoria_fs.baseDesborde || memoria_fs.desbordeFallido) return false;
+    char* ruta = ruta_desborde_libre(memoria_fs.baseDesborde);
+    if (!ruta) { memoria_fs.desbordeFallido = true; return false; }
+    // Binario: los offsets de tellp/seekg no dependen de la traducción de '\n'
+    fstream* fs = new fstream(ruta, ios::in | ios::out | ios::trunc | ios::binary);
+    if (!fs->is_open()) { delete fs; delete[] ruta; memoria_fs.desbordeFallido = true; return false; }
+    memoria_fs.desborde = fs;
+    memoria_fs.rutaDesborde = ruta;
+    return true;
+}
+
+static bool copiar_hueco(fstream& origen, fstream& destino, Nodo* f) {
+    if (f->desbordeOffset < 0) return true;
+    char* buf = new char[f->desbordeBytes > 0 ? f->desbordeBytes : 1];
+    origen.clear();
+    origen.seekg(f->desbordeOffset, ios::beg);
+    origen.read(buf, f->desbordeBytes);
+    bool ok = origen.gcount() == f->desbordeBytes;
+    if (ok) destino.write(buf, f->desbordeBytes);
+    delete[] buf;
+    return ok && !destino.fail();
+}
+
+static void compactar_desborde() {
+    // Copia los huecos en uso a un archivo nuevo; si algo falla, se conserva el actual
+    char* ruta = ruta_desborde_libre(memoria_fs.baseDesborde);
+    if (!ruta) return;
+    fstream* nuevo = new fstream(ruta, ios::in | ios::out | ios::trunc | ios::binary);
+    if (!nuevo->is_open()) { delete nuevo; delete[] ruta; return; }
+    fstream& viejo = *memoria_fs.desborde;
+    Nodo* listas[2] = { memoria_fs.lruPrimero, memoria_fs.desalojadosPrimero };
+    bool ok = true;
+    for (int k = 0; k < 2 && ok; ++k)
+        for (Nodo* f = listas[k]; f && ok; f = f->lruSiguiente) ok = copiar_hueco(viejo, *nuevo, f);
+    nuevo->flush();
+    viejo.clear();
+    if (!ok || nuevo->fail()) { nuevo->close(); delete nuevo; remove(ruta); delete[] ruta; return; }
+    // Mismo recorrido: los huecos quedaron consecutivos en el archivo nuevo
+    long long pos = 0;
+    for (int k = 0; k < 2; ++k)
+        for (Nodo* f = listas[k]; f; f = f->lruSiguiente) {
+            if (f->desbordeOffset < 0) continue;
+            f->desbordeOffset = pos;
+            f->desbordeCapacidad = f->desbordeBytes;
+            pos += f->desbordeBytes;
+        }
+    memoria_fs.bytesDesborde = pos;
+    memoria_fs.bytesMuertos = 0;
+    viejo.close();
+    delete memoria_fs.desborde;
+    remove(memoria_fs.rutaDesborde);
+    delete[] memoria_fs.rutaDesborde;
+    memoria_fs.desborde = nuevo;
+    memoria_fs.rutaDesborde = ruta;
+    ++memoria_fs.compactaciones;
+}
+
+static bool desalojar_archivo(Nodo* f) {
+    // Si el desborde ya tiene esta versión del contenido, no hace falta reescribirla
+    if (f->desbordeOffset < 0 || f->versionDesborde != f->version) {
+        if (!abrir_desborde()) return false;
+        long long tam = 0; int cnt = 0;
+        for (Linea* l = f->primeraLinea; l; l = l->siguiente) { tam += str_longitud(l->texto) + 1; ++cnt; }
+        fstream& d = *memoria_fs.desborde;
+        d.clear();
+        // Reutiliza su hueco si el contenido cabe; si no, el hueco pasa a estar muerto
+        bool reusar = f->desbordeOffset >= 0 && tam <= f->desbordeCapacidad;
+        if (reusar) d.seekp(f->desbordeOffset, ios::beg); else d.seekp(0, ios::end);
+        long long offset = (long long)d.tellp();
+        for (Linea* l = f->primeraLinea; l; l = l->siguiente) d << l->texto << "\n";
+        d.flush();
+        if (offset < 0 || d.fail()) { d.clear(); return false; }
+        if (!reusar) {
+            liberar_hueco_desborde(f);
+            f->desbordeOffset = offset;
+            f->desbordeCapacidad = tam;
+            memoria_fs.bytesDesborde += tam;
+        }
+        f->desbordeBytes = tam;
+        f->desbordeLineas = cnt;
+        f->versionDesborde = f->version;
+    }
+    liberar_lineas(f->primeraLinea);
+    f->primeraLinea = nullptr;
+    f->desalojado = true;
+    memoria_fs.bytesVivos -= f->bytesResidentes;
+    f->bytesResidentes = 0;
+    quitar_de_lru(f);
+    lista_al_frente(memoria_fs.desalojadosPrimero, memoria_fs.desalojadosUltimo, f);
+    ++memoria_fs.desalojos;
+    if (memoria_fs.bytesMuertos > memoria_fs.bytesDesborde) compactar_desborde();
+    return true;
+}
+
+static void aplicar_presupuesto(Nodo* protegido) {
+    if (memoria_fs.presupuesto <= 0) return;
+    while (memoria_fs.bytesVivos > memoria_fs.presupuesto) {
+        Nodo* v = memoria_fs.lruUltimo;
+        if (!v || v == protegido) return;
+        if (!desalojar_archivo(v)) return;
+    }
+}
+
+static bool recuperar_de_desborde(Nodo* f) {
+    if (!memoria_fs.desborde) return false;
+    fstream& d = *memoria_fs.desborde;
+    d.clear();
+    d.seekg(f->desbordeOffset, ios::beg);
+    Linea* cabeza = nullptr;
+    Linea* cola = nullptr;
+    for (int j = 0; j < f->desbordeLineas; ++j) {
+        char* t = leer_linea_alloc(d, 1024);
+        // Lectura corta: el archivo sigue desalojado en lugar de quedar con líneas vacías
+        if (!t) { liberar_lineas(cabeza); d.clear(); return false; }
+        Linea* nl = new Linea(); nl->texto = t; nl->siguiente = nullptr;
+        if (cola) cola->siguiente = nl; else cabeza = nl;
+        cola = nl;
+    }
+    d.clear();
+    f->primeraLinea = cabeza;
+    f->desalojado = false;
+    // El hueco se conserva: si no cambia, desalojarlo de nuevo no escribe nada
+    lista_quitar(memoria_fs.desalojadosPrimero, memoria_fs.desalojadosUltimo, f);
+    return true;
+}
+
+// Recorre las líneas de f sin traerlo a memoria (para serializar)
+static int contar_lineas_archivo(Nodo* f) {
+    if (f->desalojado) return f->desbordeLineas;
+    int cnt = 0; Linea* l = f->primeraLinea; while (l) { ++cnt; l = l->siguiente; }
+    return cnt;
+}
+
+// false si el desborde no devuelve todas las líneas: el guardado debe fallar
+static bool emitir_lineas_archivo(Nodo* f, ostream& out) {
+    if (!f->desalojado) {
+        Linea* l = f->primeraLinea; while (l) { out << l->texto << "\n"; l = l->siguiente; }
+        return true;
+    }
+    if (!memoria_fs.desborde) return false;
+    fstream& d = *memoria_fs.desborde;
+    d.clear();
+    d.seekg(f->desbordeOffset, ios::beg);
+    bool ok = true;
+    for (int j = 0; j < f->desbordeLineas && ok; ++j) {
+        char* t = leer_linea_alloc(d, 1024);
+        if (!t) { ok = false; break; }
+        out << t << "\n";
+        delete[] t;
+    }
+    d.clear();
+    return ok;
+}
+
+void configurar_memoria(long long presupuesto, const char* baseDesborde) {
+    memoria_fs.presupuesto = presupuesto > 0 ? presupuesto : 0;
+    memoria_fs.desbordeFallido = false; // reintentar abrir el desborde
+    // La base no cambia una vez abierto: hay contenidos que dependen del archivo
+    if (baseDesborde && !memoria_fs.desborde) {
+        if (memoria_fs.baseDesborde) delete[] memoria_fs.baseDesborde;
+        memoria_fs.baseDesborde = str_duplicar(baseDesborde);
+    }
+    aplicar_presupuesto(nullptr);
+}
+
+bool asegurar_residente(Nodo* f) {
+    if (!f || f->tipo != NODO_ARCHIVO) return false;
+    if (f->desalojado) {
+        ++memoria_fs.fallos;
+        if (!recuperar_de_desborde(f)) return false;
+        contabilizar_archivo(f);
+    } else {
+        ++memoria_fs.aciertos;
+        if (f->bytesResidentes > 0) poner_al_frente_lru(f);
+    }
+    return true;
+}
+
+void contabilizar_archivo(Nodo* f) {
+    if (!f || f->tipo != NODO_ARCHIVO || f->desalojado) return;
+    long long b = bytes_de_lineas(f->primeraLinea);
+    memoria_fs.bytesVivos += b - f->bytesResidentes;
+    f->bytesResidentes = b;
+    // Un archivo vacío no libera nada al desalojarse ni necesita su hueco
+    if (b > 0) poner_al_frente_lru(f); else { quitar_de_lru(f); liberar_hueco_desborde(f); }
+    aplicar_presupuesto(f);
+}
+
+void imprimir_estado_memoria(ostream& out) {
+    out << "Presupuesto: ";
+    if (memoria_fs.presupuesto > 0) out << memoria_fs.presupuesto << " bytes\n"; else out << "sin límite\n";
+    out << "Bytes vivos: " << memoria_fs.bytesVivos << "\n";
+    out << "Aciertos: " << memoria_fs.aciertos << "  Fallos: " << memoria_fs.fallos
+        << "  Desalojos: " << memoria_fs.desalojos << "\n";
+    if (memoria_fs.desborde) {
+        memoria_fs.desborde->clear();
+        memoria_fs.desborde->seekp(0, ios::end);
+        out << "Desborde: " << memoria_fs.rutaDesborde << " (" << (long long)memoria_fs.desborde->tellp() << " bytes, "
+            << memoria_fs.bytesMuertos << " muertos, " << memoria_fs.compactaciones << " compactaciones)\n";
+    } else if (memoria_fs.desbordeFallido) {
+        out << "Error: no se puede abrir el desborde de '" << memoria_fs.baseDesborde
+            << "' (¿archivos .swp de ejecuciones anteriores?); el presupuesto no se aplica\n";
+    }
+}
+
+void cerrar_memoria() {
+    if (memoria_fs.desborde) {
+        memoria_fs.desborde->close();
+        delete memoria_fs.desborde;
+        memoria_fs.desborde = nullptr;
+        remove(memoria_fs.rutaDesborde);
+    }
+    if (memoria_fs.rutaDesborde) { delete[] memoria_fs.rutaDesborde; memoria_fs.rutaDesborde = nullptr; }
+    if (memoria_fs.baseDesborde) { delete[] memoria_fs.baseDesborde; memoria_fs.baseDesborde = nullptr; }
+}
+
 void liberar_lineas(Linea* l) {
     while (l) { Linea* nx = l->siguiente; if (l->texto) delete[] l->texto; delete l; l = nx; }
 }
@@ -142,6 +526,12 @@ void liberar_arbol(Nodo* raiz) {
     // Liberación postorden
     Nodo* ch = raiz->primerHijo;
     while (ch) { Nodo* nx = ch->siguienteHermano; liberar_arbol(ch); ch = nx; }
+    if (raiz->tipo == NODO_ARCHIVO) {
+        memoria_fs.bytesVivos -= raiz->bytesResidentes;
+        if (raiz->desalojado) lista_quitar(memoria_fs.desalojadosPrimero, memoria_fs.desalojadosUltimo, raiz);
+        else quitar_de_lru(raiz);
+        liberar_hueco_desborde(raiz);
+    }
     if (raiz->primeraLinea) liberar_lineas(raiz->primeraLinea);
     if (raiz->nombre) delete[] raiz->nombre;
     delete raiz;
@@ -177,12 +567,21 @@ void desvincular_de_padre(Nodo* n) {
     }
 }
 
+void marcar_sucio(Nodo* n) {
+    if (!n) return;
+    n->sucio = true; ++n->version;
+    // Si un ancestro ya está marcado, los superiores también lo están
+    for (Nodo* a = n->padre; a && !a->subarbolSucio; a = a->padre) a->subarbolSucio = true;
+}
+
 Nodo* crear_directorio(Nodo* cwd, const char* nombre, ostream& out) {
     if (!cwd || cwd->tipo != NODO_DIR) { out << "Error: directorio actual inválido\n"; return nullptr; }
     if (!nombre_valido(nombre)) { out << "Error: nombre inválido\n"; return nullptr; }
     if (tiene_hijo_llamado(cwd, nombre)) { out << "Error: ya existe en el directorio\n"; return nullptr; }
     Nodo* n = crear_nodo(NODO_DIR, nombre, cwd);
     enlazar_hijo_al_frente(cwd, n);
+    marcar_sucio(cwd);
+    marcar_sucio(n);
     return n;
 }
 
@@ -197,6 +596,8 @@ Nodo* crear_archivo(Nodo* cwd, const char* nombre, ostream& out) {
     }
     Nodo* n = crear_nodo(NODO_ARCHIVO, nombre, cwd);
     enlazar_hijo_al_frente(cwd, n);
+    marcar_sucio(cwd);
+    marcar_sucio(n);
     return n;
 }
 
@@ -223,9 +624,15 @@ bool mover_nodo(Nodo* item, Nodo* nuevoPadre, const char* nuevoNombre, ostream&
     const char* nombreFinal = nuevoNombre && nombre_valido(nuevoNombre) ? nuevoNombre : item->nombre;
     if (!nombre_valido(nombreFinal)) { out << "Error: nombre destino inválido\n"; return false; }
     if (tiene_hijo_llamado(nuevoPadre, nombreFinal)) { out << "Error: colisión de nombre en destino\n"; return false; }
+    marcar_sucio(item->padre); // el origen pierde la entrada
     desvincular_de_padre(item);
     if (nuevoNombre && !str_igual(nuevoNombre, item->nombre)) { delete[] item->nombre; item->nombre = str_duplicar(nuevoNombre); }
     enlazar_hijo_al_frente(nuevoPadre, item);
+    // El nodo conserva su segmento; solo cambian las listas de ambos padres
+    marcar_sucio(nuevoPadre);
+    // Cambios pendientes de un guardado fallido deben seguir alcanzables desde la raíz
+    if (item->sucio || item->subarbolSucio)
+        for (Nodo* a = nuevoPadre; a && !a->subarbolSucio; a = a->padre) a->subarbolSucio = true;
     return true;
 }
 
@@ -290,6 +697,7 @@ char* construir_ruta_absoluta(Nodo* n) {
 
 void imprimir_archivo(Nodo* f, ostream& out) {
     if (!f || f->tipo != NODO_ARCHIVO) { out << "Error: no es archivo\n"; return; }
+    if (!asegurar_residente(f)) { out << "Error: no se puede leer el desborde\n"; return; }
     int i = 1;
     Linea* l = f->primeraLinea;
     while (l) { out << i << ": " << l->texto << "\n"; l = l->siguiente; ++i; }
@@ -301,6 +709,7 @@ static Linea* obtener_linea_en(Linea* cabeza, int idx) {
 
 bool editar_archivo(Nodo* f, istream& in, ostream& out) {
     if (!f || f->tipo != NODO_ARCHIVO) { out << "Error: no es archivo\n"; return false; }
+    if (!asegurar_residente(f)) { out << "Error: no se puede leer el desborde\n"; return false; }
     out << "Editor (:p mostrar, :a append, :i N, :r N, :d N, :wq guardar, :q! salir)\n";
     char buf[1024];
     while (true) {
@@ -318,6 +727,7 @@ bool editar_archivo(Nodo* f, istream& in, ostream& out) {
                 if (!f->primeraLinea) f->primeraLinea = nl; else {
                     Linea* c = f->primeraLinea; while (c->siguiente) c = c->siguiente; c->siguiente = nl;
                 }
+                marcar_sucio(f); contabilizar_archivo(f);
                 continue;
             }
             if (buf[1] == 'i') { // :i N luego la siguiente línea para insertar antes de N
@@ -331,6 +741,7 @@ bool editar_archivo(Nodo* f, istream& in, ostream& out) {
                     if (!prev) { out << "línea fuera de rango\n"; delete[] t; delete nl; continue; }
                     nl->siguiente = prev->siguiente; prev->siguiente = nl;
                 }
+                marcar_sucio(f); contabilizar_archivo(f);
                 continue;
             }
             if (buf[1] == 'r') { // :r N reemplaza N con la siguiente línea
@@ -338,15 +749,15 @@ bool editar_archivo(Nodo* f, istream& in, ostream& out) {
                 Linea* tgt = obtener_linea_en(f->primeraLinea, N);
                 if (!tgt) { out << "línea no existe\n"; continue; }
                 out << "texto: "; char* t = leer_linea_alloc(in, 1024); if (!t) continue;
-                if (tgt->texto) delete[] tgt->texto; tgt->texto = t; continue;
+                if (tgt->texto) delete[] tgt->texto; tgt->texto = t; marcar_sucio(f); contabilizar_archivo(f); continue;
             }
             if (buf[1] == 'd') { // :d N eliminar
                 int N = 0; for (int i = 3; buf[i]; ++i) if (buf[i] >= '0' && buf[i] <= '9') { N = N*10 + (buf[i]-'0'); }
                 if (N <= 0) { out << "N inválido\n"; continue; }
-                if (N == 1) { Linea* del = f->primeraLinea; if (del) { f->primeraLinea = del->siguiente; if (del->texto) delete[] del->texto; delete del; } continue; }
+                if (N == 1) { Linea* del = f->primeraLinea; if (del) { f->primeraLinea = del->siguiente; if (del->texto) delete[] del->texto; delete del; marcar_sucio(f); contabilizar_archivo(f); } continue; }
                 int i2 = 1; Linea* prev = f->primeraLinea; while (prev && i2 < N-1) { prev = prev->siguiente; ++i2; }
                 if (!prev || !prev->siguiente) { out << "línea no existe\n"; continue; }
-                Linea* del = prev->siguiente; prev->siguiente = del->siguiente; if (del->texto) delete[] del->texto; delete del; continue;
+                Linea* del = prev->siguiente; prev->siguiente = del->siguiente; if (del->texto) delete[] del->texto; delete del; marcar_sucio(f); contabilizar_archivo(f); continue;
             }
             out << "Comando desconocido\n"; continue;
         } else {
@@ -366,7 +777,7 @@ static Nodo* asegurar_directorio_absoluto(Nodo* raiz, const char* rutaAbs, ostre
         token[tlen] = '\0';
         if (tlen == 0) continue;
         Nodo* nxt = buscar_hijo(cur, token);
-        if (!nxt) { nxt = crear_nodo(NODO_DIR, token, cur); enlazar_hijo_al_frente(cur, nxt); }
+        if (!nxt) { nxt = crear_nodo(NODO_DIR, token, cur); enlazar_hijo_al_frente(cur, nxt); marcar_sucio(cur); marcar_sucio(nxt); }
         cur = nxt;
     }
     return cur;
@@ -381,22 +792,23 @@ bool serializar_arbol(Nodo* raiz, ostream& out) {
     auto push = [&](Nodo* x){ Pila* s = new Pila{ x, st }; st = s; };
     auto pop = [&](){ if (!st) return (Nodo*)nullptr; Pila* s = st; Nodo* x = s->n; st = s->sig; delete s; return x; };
     push(raiz);
-    while (st) {
+    bool ok = true;
+    while (st && ok) {
         Nodo* n = pop();
         if (n != raiz) {
             char* p = construir_ruta_absoluta(n);
             if (n->tipo == NODO_DIR) out << "D " << p << "\n";
             else {
-                int cnt = 0; Linea* l = n->primeraLinea; while (l) { ++cnt; l = l->siguiente; }
-                out << "F " << p << " " << cnt << "\n";
-                l = n->primeraLinea; while (l) { out << l->texto << "\n"; l = l->siguiente; }
+                out << "F " << p << " " << contar_lineas_archivo(n) << "\n";
+                ok = emitir_lineas_archivo(n, out);
             }
             delete[] p;
         }
         // apilar hijos
         Nodo* c = n->primerHijo; while (c) { push(c); c = c->siguienteHermano; }
     }
-    return true;
+    while (st) pop(); // vaciar la pila si se interrumpió
+    return ok;
 }
 
 bool deserializar_arbol(Nodo* raiz, istream& in, ostream& out) {
@@ -405,6 +817,11 @@ bool deserializar_arbol(Nodo* raiz, istream& in, ostream& out) {
     while (in.getline(line, 1024)) {
         if (line[0] == '\0') continue;
         char type = line[0];
+        if (type == 'G' && line[1] == ' ') { // generación de la exportación
+            int i = 2; unsigned g = 0; while (line[i] >= '0' && line[i] <= '9') { g = g*10 + (unsigned)(line[i]-'0'); ++i; }
+            if (g > generacion_guardado) generacion_guardado = g;
+            continue;
+        }
         // Ignorar líneas que no sean entradas de datos
         if (!(type == 'D' || type == 'F')) continue;
         if (line[1] != ' ') { out << "Formato inválido\n"; return false; }
@@ -435,7 +852,8 @@ bool deserializar_arbol(Nodo* raiz, istream& in, ostream& out) {
             char nombre[256]; int nl = 0; for (int k = lastSlash+1; k < plen && nl < 255; ++k) nombre[nl++] = path[k]; nombre[nl] = '\0';
             if (!padre) { out << "Padre inválido\n"; return false; }
             Nodo* f = buscar_hijo(padre, nombre);
-            if (!f) { f = crear_nodo(NODO_ARCHIVO, nombre, padre); enlazar_hijo_al_frente(padre, f); }
+            if (!f) { f = crear_nodo(NODO_ARCHIVO, nombre, padre); enlazar_hijo_al_frente(padre, f); marcar_sucio(padre); marcar_sucio(f); }
+            else if (!asegurar_residente(f)) { out << "Error: no se puede leer el desborde\n"; return false; }
             // leer N líneas
             for (int j = 0; j < N; ++j) {
                 char* t = leer_linea_alloc(in, 1024);
@@ -443,6 +861,8 @@ bool deserializar_arbol(Nodo* raiz, istream& in, ostream& out) {
                 Linea* nl2 = new Linea(); nl2->texto = t; nl2->siguiente = nullptr;
                 if (!f->primeraLinea) f->primeraLinea = nl2; else { Linea* c = f->primeraLinea; while (c->siguiente) c = c->siguiente; c->siguiente = nl2; }
             }
+            if (N > 0) marcar_sucio(f);
+            contabilizar_archivo(f);
         } else {
             out << "Tipo desconocido\n"; return false;
         }
@@ -450,6 +870,366 @@ bool deserializar_arbol(Nodo* raiz, istream& in, ostream& out) {
     return true;
 }
 
+// ---- Persistencia por segmentos ----
+
+static unsigned leer_unsigned(const char* s, int& i) {
+    while (s[i] == ' ') ++i;
+    unsigned v = 0; while (s[i] >= '0' && s[i] <= '9') { v = v*10 + (unsigned)(s[i]-'0'); ++i; }
+    return v;
+}
+
+static bool reemplazar_archivo(const char* tmp, const char* ruta) {
+    // rename() reemplaza de forma atómica en POSIX; en Windows falla si el destino existe
+    if (rename(tmp, ruta) == 0) return true;
+    remove(ruta);
+    return rename(tmp, ruta) == 0;
+}
+
+static char* ruta_segmento(const char* base, unsigned id, unsigned gen) {
+    // "<base>.<id>.<gen>.seg": cada guardado escribe nombres nuevos
+    char* prefijo = ruta_con_sufijo(base, id, true, "");
+    char* r = ruta_con_sufijo(prefijo, gen, true, ".seg");
+    delete[] prefijo;
+    return r;
+}
+
+// Generación del segmento de c que referenciará el guardado en curso
+static unsigned segmento_destino(Nodo* c, unsigned gen) {
+    return (c->sucio || c->subarbolSucio) ? gen : c->segmento;
+}
+
+static bool escribir_segmento(Nodo* n, const char* base, unsigned gen, ostream& out) {
+    // Nombre nuevo: el segmento vigente sigue intacto hasta que cambie el manifiesto
+    char* ruta = ruta_segmento(base, n->id, gen);
+    ofstream ofs(ruta, ios::out | ios::trunc);
+    bool ok = ofs.is_open();
+    if (ok) {
+        if (n->tipo == NODO_DIR) {
+            ofs << "V " << n->id << " " << n->version << "\n";
+            Nodo* c = n->primerHijo;
+            while (c) {
+                ofs << (c->tipo == NODO_DIR ? "D " : "F ") << c->id << " " << segmento_destino(c, gen) << " " << c->nombre << "\n";
+                c = c->siguienteHermano;
+            }
+        } else {
+            ofs << "V " << n->id << " " << n->version << " " << contar_lineas_archivo(n) << "\n";
+            ok = emitir_lineas_archivo(n, ofs);
+        }
+        if (ok) ofs << "E\n"; // marca de fin: un segmento sin ella está incompleto
+        ofs.close();
+        ok = ok && !ofs.fail();
+    }
+    if (!ok) { out << "Error: no se puede escribir el segmento '" << ruta << "'\n"; remove(ruta); }
+    delete[] ruta;
+    return ok;
+}
+
+// Nodos escritos por el guardado en curso, pendientes de confirmar
+struct Escrito { Nodo* n; Escrito* sig; };
+
+static bool guardar_subarbol(Nodo* n, const char* base, unsigned gen, Escrito*& hechos, ostream& out) {
+    // n está sucio o tiene descendientes sucios. Hijos primero: el directorio
+    // referencia los nombres nuevos de sus hijos. Las marcas no se tocan hasta confirmar
+    if (n->subarbolSucio) {
+        Nodo* c = n->primerHijo;
+        while (c) {
+            if ((c->sucio || c->subarbolSucio) && !guardar_subarbol(c, base, gen, hechos, out)) return false;
+            c = c->siguienteHermano;
+        }
+    }
+    if (!escribir_segmento(n, base, gen, out)) return false;
+    hechos = new Escrito{ n, hechos };
+    return true;
+}
+
+static void confirmar_guardado(Escrito* hechos, const char* base, unsigned gen) {
+    // El manifiesto ya apunta a los nombres nuevos: se borran los reemplazados
+    while (hechos) {
+        Escrito* e = hechos; hechos = e->sig;
+        Nodo* n = e->n;
+        if (n->segmento) { char* r = ruta_segmento(base, n->id, n->segmento); remove(r); delete[] r; }
+        n->segmento = gen;
+        n->sucio = false;
+        n->subarbolSucio = false;
+        delete e;
+    }
+}
+
+static void deshacer_guardado(Escrito* hechos, const char* base, unsigned gen) {
+    while (hechos) {
+        Escrito* e = hechos; hechos = e->sig;
+        char* r = ruta_segmento(base, e->n->id, gen); remove(r); delete[] r;
+        delete e;
+    }
+}
+
+struct Manifiesto { unsigned idRaiz, segRaiz, siguienteId, generacion, huellaTexto; };
+
+// Árbol de segmentos de un manifiesto anterior que se borra tras el próximo manifiesto
+static char* limpieza_base = nullptr;
+static unsigned limpieza_id = 0, limpieza_seg = 0;
+
+static bool leer_manifiesto(const char* base, Manifiesto& m) {
+    char* ruta = ruta_con_sufijo(base, 0, false, ".man");
+    ifstream ifs(ruta, ios::in);
+    delete[] ruta;
+    if (!ifs.is_open()) return false;
+    char line[128];
+    if (!ifs.getline(line, 128) || line[0] != 'M' || line[1] != ' ') return false;
+    int i = 2;
+    m.idRaiz = leer_unsigned(line, i);
+    m.segRaiz = leer_unsigned(line, i);
+    m.siguienteId = leer_unsigned(line, i);
+    m.generacion = leer_unsigned(line, i);
+    m.huellaTexto = leer_unsigned(line, i);
+    return true;
+}
+
+static unsigned huella_archivo(const char* ruta) {
+    // FNV-1a de todo el contenido; 0 si no existe
+    ifstream ifs(ruta, ios::in | ios::binary);
+    if (!ifs.is_open()) return 0;
+    unsigned h = 2166136261u;
+    char buf[4096];
+    while (ifs.read(buf, 4096) || ifs.gcount() > 0) {
+        streamsize n = ifs.gcount();
+        for (streamsize k = 0; k < n; ++k) { h ^= (unsigned char)buf[k]; h *= 16777619u; }
+    }
+    return h ? h : 1;
+}
+
+// Ids ya visitados al recorrer segmentos (direccionamiento abierto, 0 = libre)
+struct ConjuntoIds { unsigned* tabla; unsigned capacidad; unsigned usados; };
+
+static void conjunto_colocar(unsigned* tabla, unsigned capacidad, unsigned id) {
+    unsigned j = (id * 2654435761u) & (capacidad - 1);
+    while (tabla[j]) j = (j + 1) & (capacidad - 1);
+    tabla[j] = id;
+}
+
+// false si id es 0 o ya estaba: segmento repetido o ciclo
+static bool conjunto_insertar(ConjuntoIds& c, unsigned id) {
+    if (id == 0) return false;
+    for (unsigned j = c.capacidad ? (id * 2654435761u) & (c.capacidad - 1) : 0; c.capacidad && c.tabla[j]; j = (j + 1) & (c.capacidad - 1))
+        if (c.tabla[j] == id) return false;
+    if ((c.usados + 1) * 2 > c.capacidad) {
+        unsigned nueva = c.capacidad ? c.capacidad * 2 : 64;
+        unsigned* t = new unsigned[nueva]();
+        for (unsigned k = 0; k < c.capacidad; ++k) if (c.tabla[k]) conjunto_colocar(t, nueva, c.tabla[k]);
+        delete[] c.tabla;
+        c.tabla = t; c.capacidad = nueva;
+    }
+    conjunto_colocar(c.tabla, c.capacidad, id);
+    ++c.usados;
+    return true;
+}
+
+static void borrar_arbol_segmentos(const char* base, unsigned id, unsigned gen, ConjuntoIds& vistos) {
+    // Lee las entradas, borra el segmento y luego recorre los hijos
+    struct Hijo { unsigned id, gen; bool dir; Hijo* sig; };
+    Hijo* hijos = nullptr;
+    if (!conjunto_insertar(vistos, id)) return;
+    char* ruta = ruta_segmento(base, id, gen);
+    ifstream ifs(ruta, ios::in);
+    if (ifs.is_open()) {
+        char line[1024];
+        while (ifs.getline(line, 1024)) {
+            if ((line[0] != 'D' && line[0] != 'F') || line[1] != ' ') continue;
+            int i = 2;
+            unsigned idHijo = leer_unsigned(line, i);
+            unsigned genHijo = leer_unsigned(line, i);
+            hijos = new Hijo{ idHijo, genHijo, line[0] == 'D', hijos };
+        }
+        ifs.close();
+    }
+    remove(ruta);
+    delete[] ruta;
+    while (hijos) {
+        Hijo* h = hijos; hijos = h->sig;
+        if (h->dir) borrar_arbol_segmentos(base, h->id, h->gen, vistos);
+        else if (conjunto_insertar(vistos, h->id)) { char* r = ruta_segmento(base, h->id, h->gen); remove(r); delete[] r; }
+        delete h;
+    }
+}
+
+static void limpiar_segmentos_obsoletos(const char* base) {
+    if (!limpieza_base || !str_igual(limpieza_base, base)) return;
+    ConjuntoIds vistos = { nullptr, 0, 0 };
+    borrar_arbol_segmentos(base, limpieza_id, limpieza_seg, vistos);
+    delete[] vistos.tabla;
+    delete[] limpieza_base; limpieza_base = nullptr;
+}
+
+static bool escribir_manifiesto(Nodo* raiz, const char* base, unsigned gen, unsigned huellaTexto, ostream& out) {
+    char* ruta = ruta_con_sufijo(base, 0, false, ".man");
+    char* tmp = ruta_con_sufijo(ruta, 0, false, ".tmp");
+    ofstream ofs(tmp, ios::out | ios::trunc);
+    bool ok = ofs.is_open();
+    if (ok) {
+        ofs << "M " << raiz->id << " " << segmento_destino(raiz, gen) << " " << siguiente_id_nodo
+            << " " << gen << " " << huellaTexto << "\n";
+        ofs.close();
+        ok = !ofs.fail() && reemplazar_archivo(tmp, ruta);
+    }
+    if (!ok) { out << "Error: no se puede escribir el manifiesto '" << ruta << "'\n"; remove(tmp); }
+    delete[] tmp;
+    delete[] ruta;
+    return ok;
+}
+
+static bool guardar_con_manifiesto(Nodo* raiz, const char* base, unsigned gen, Escrito* hechos, unsigned huellaTexto, ostream& out) {
+    // El rename del manifiesto es el único punto de confirmación del guardado
+    if (!escribir_manifiesto(raiz, base, gen, huellaTexto, out)) { deshacer_guardado(hechos, base, gen); return false; }
+    confirmar_guardado(hechos, base, gen);
+    limpiar_segmentos_obsoletos(base);
+    return true;
+}
+
+bool guardar_segmentos(Nodo* raiz, const char* base, ostream& out) {
+    if (!raiz || !base) return false;
+    unsigned gen = ++generacion_guardado;
+    Escrito* hechos = nullptr;
+    if ((raiz->sucio || raiz->subarbolSucio) && !guardar_subarbol(raiz, base, gen, hechos, out)) {
+        deshacer_guardado(hechos, base, gen);
+        return false;
+    }
+    return guardar_con_manifiesto(raiz, base, gen, hechos, 0, out);
+}
+
+bool exportar_texto(Nodo* raiz, const char* base, ostream& out) {
+    if (!raiz || !base) return false;
+    // Si fallan los segmentos la exportación se escribe igual; sin manifiesto
+    // nuevo, su generación mayor hace que se cargue el texto
+    unsigned gen = ++generacion_guardado;
+    Escrito* hechos = nullptr;
+    bool segmentosOk = !(raiz->sucio || raiz->subarbolSucio) || guardar_subarbol(raiz, base, gen, hechos, out);
+    char* tmp = ruta_con_sufijo(base, 0, false, ".tmp");
+    ofstream ofs(tmp, ios::out | ios::trunc);
+    bool ok = ofs.is_open();
+    if (ok) {
+        ofs << "G " << gen << "\n";
+        ok = serializar_arbol(raiz, ofs);
+        ofs.close();
+        ok = ok && !ofs.fail() && reemplazar_archivo(tmp, base);
+    }
+    if (!ok) { out << "Error: no se puede guardar en '" << base << "'\n"; remove(tmp); }
+    delete[] tmp;
+    if (!ok || !segmentosOk) { deshacer_guardado(hechos, base, gen); return false; }
+    return guardar_con_manifiesto(raiz, base, gen, hechos, huella_archivo(base), out);
+}
+
+bool segmentos_vigentes(const char* base) {
+    Manifiesto m;
+    if (!leer_manifiesto(base, m)) return false;
+    ifstream ifs(base, ios::in);
+    if (!ifs.is_open()) return true;
+    char line[64]; unsigned gt = 0;
+    if (ifs.getline(line, 64) && line[0] == 'G' && line[1] == ' ') { int i = 2; gt = leer_unsigned(line, i); }
+    ifs.close();
+    // Sin línea "G" el texto no lo escribió exportar_texto (formato anterior o
+    // editado a mano): manda el texto
+    if (gt == 0) return false;
+    if (gt != m.generacion) return gt < m.generacion;
+    // Misma generación: los segmentos valen si el texto no cambió desde la exportación
+    return m.huellaTexto != 0 && huella_archivo(base) == m.huellaTexto;
+}
+
+void descartar_segmentos(Nodo* raiz, const char* base) {
+    Manifiesto m;
+    if (!leer_manifiesto(base, m)) return;
+    // Los ids nuevos no deben pisar segmentos que el manifiesto anterior aún referencia
+    if (m.siguienteId > siguiente_id_nodo) siguiente_id_nodo = m.siguienteId;
+    if (raiz && raiz->id < m.siguienteId) raiz->id = siguiente_id_nodo++;
+    if (m.generacion > generacion_guardado) generacion_guardado = m.generacion;
+    if (limpieza_base) delete[] limpieza_base;
+    limpieza_base = str_duplicar(base);
+    limpieza_id = m.idRaiz;
+    limpieza_seg = m.segRaiz;
+}
+
+static bool abrir_segmento(ifstream& ifs, const char* base, unsigned id, unsigned gen, ConjuntoIds& vistos,
+                           unsigned& version, unsigned& lineas, ostream& out) {
+    // Cada id aparece una sola vez en el árbol; si no, el manifiesto no es confiable
+    if (!conjunto_insertar(vistos, id)) { out << "Segmento repetido: " << id << "\n"; return false; }
+    char* ruta = ruta_segmento(base, id, gen);
+    ifs.open(ruta, ios::in);
+    delete[] ruta;
+    if (!ifs.is_open()) { out << "Segmento faltante: " << id << "." << gen << "\n"; return false; }
+    char line[128];
+    if (!ifs.getline(line, 128) || line[0] != 'V' || line[1] != ' ') { out << "Segmento inválido: " << id << "\n"; return false; }
+    int i = 2;
+    if (leer_unsigned(line, i) != id) { out << "Segmento inconsistente: " << id << "\n"; return false; }
+    version = leer_unsigned(line, i);
+    lineas = leer_unsigned(line, i);
+    if (id >= siguiente_id_nodo) siguiente_id_nodo = id + 1;
+    return true;
+}
+
+static bool cargar_cuerpo(Nodo* f, unsigned id, unsigned gen, const char* base, ConjuntoIds& vistos, ostream& out) {
+    ifstream ifs;
+    unsigned version = 0, n = 0;
+    if (!abrir_segmento(ifs, base, id, gen, vistos, version, n, out)) return false;
+    f->id = id; f->version = version;
+    Linea* cola = nullptr;
+    for (unsigned j = 0; j < n; ++j) {
+        // Las líneas ya anexadas se liberan con el árbol si la carga falla
+        char* t = leer_linea_alloc(ifs, 1024);
+        if (!t) { out << "Segmento truncado: " << id << "\n"; return false; }
+        Linea* nl = new Linea(); nl->texto = t; nl->siguiente = nullptr;
+        if (cola) cola->siguiente = nl; else f->primeraLinea = nl;
+        cola = nl;
+    }
+    char fin[8];
+    if (!ifs.getline(fin, 8) || !str_igual(fin, "E")) { out << "Segmento truncado: " << id << "\n"; return false; }
+    f->segmento = gen;
+    f->sucio = false;
+    contabilizar_archivo(f);
+    return true;
+}
+
+static bool cargar_segmento(Nodo* dir, unsigned id, unsigned gen, const char* base, ConjuntoIds& vistos, ostream& out) {
+    ifstream ifs;
+    unsigned version = 0, sinUso = 0;
+    if (!abrir_segmento(ifs, base, id, gen, vistos, version, sinUso, out)) return false;
+    dir->id = id; dir->version = version;
+    Nodo* ultimo = nullptr; // anexar al final para conservar el orden guardado
+    bool completo = false;
+    char line[1024];
+    while (ifs.getline(line, 1024)) {
+        if (str_igual(line, "E")) { completo = true; break; }
+        char type = line[0];
+        if (!(type == 'D' || type == 'F') || line[1] != ' ') { out << "Formato inválido\n"; return false; }
+        int i = 2;
+        unsigned idHijo = leer_unsigned(line, i);
+        unsigned genHijo = leer_unsigned(line, i);
+        if (line[i] == ' ') ++i;
+        if (!nombre_valido(line + i)) { out << "Nombre inválido en segmento " << id << "\n"; return false; }
+        Nodo* hijo = crear_nodo(type == 'D' ? NODO_DIR : NODO_ARCHIVO, line + i, dir);
+        if (ultimo) ultimo->siguienteHermano = hijo; else dir->primerHijo = hijo;
+        ultimo = hijo;
+        bool ok = type == 'D' ? cargar_segmento(hijo, idHijo, genHijo, base, vistos, out)
+                              : cargar_cuerpo(hijo, idHijo, genHijo, base, vistos, out);
+        if (!ok) return false;
+    }
+    if (!completo) { out << "Segmento truncado: " << id << "\n"; return false; }
+    dir->segmento = gen;
+    dir->sucio = false; dir->subarbolSucio = false;
+    return true;
+}
+
+bool cargar_segmentos(Nodo* raiz, const char* base, ostream& out) {
+    if (!raiz || !base) return false;
+    Manifiesto m;
+    if (!leer_manifiesto(base, m)) return false;
+    ConjuntoIds vistos = { nullptr, 0, 0 };
+    bool ok = cargar_segmento(raiz, m.idRaiz, m.segRaiz, base, vistos, out);
+    delete[] vistos.tabla;
+    if (!ok) return false;
+    if (m.siguienteId > siguiente_id_nodo) siguiente_id_nodo = m.siguienteId;
+    if (m.generacion > generacion_guardado) generacion_guardado = m.generacion;
+    return true;
+}
+
 char* leer_linea_alloc(istream& in, int maxLen) {
     char* buf = new char[maxLen];
     if (!in.getline(buf, maxLen)) { delete[] buf; return nullptr; }
@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <climits>
 #include "fs.h"
 using namespace std;
 
@@ -12,16 +13,27 @@ static void imprimir_prompt(Nodo* cwd) {
 	delete[] p;
 }
 
-static void guardado_automatico(Nodo* raiz, const char* archivoAbierto, const char* rutaPorDefecto) {
+static void guardado_automatico(Nodo* raiz, char*& archivoAbierto, const char* rutaPorDefecto) {
 	const char* ruta = archivoAbierto ? archivoAbierto : rutaPorDefecto;
-	ofstream ofs(ruta, ios::out | ios::trunc);
-	if (!ofs.is_open()) {
-		cout << "Error: no se puede guardar en '" << ruta << "'\n";
-		return;
+	// Solo reescribe los segmentos modificados; la exportación de texto
+	// completa se escribe al salir. Los errores ya los informa guardar_segmentos
+	if (guardar_segmentos(raiz, ruta, cout) && !archivoAbierto) {
+		// Primera sesión sin archivo: al salir se exporta junto a los segmentos
+		archivoAbierto = str_duplicar(rutaPorDefecto);
 	}
-	serializar_arbol(raiz, ofs);
-	ofs.close();
-	// Guardado silencioso
+}
+
+static bool cargar_persistencia(Nodo*& raiz, const char* ruta, ostream& out) {
+	// Segmentos si son más nuevos que la exportación de texto y están completos
+	if (segmentos_vigentes(ruta) && cargar_segmentos(raiz, ruta, out)) return true;
+	liberar_arbol(raiz);
+	raiz = crear_nodo(NODO_DIR, "", nullptr);
+	descartar_segmentos(raiz, ruta);
+	ifstream ifs(ruta, ios::in);
+	if (!ifs.is_open()) return false;
+	deserializar_arbol(raiz, ifs, out);
+	ifs.close();
+	return true;
 }
 
 static bool contieneBarra(const char* s) {
@@ -30,6 +42,19 @@ static bool contieneBarra(const char* s) {
 	return false;
 }
 
+static long long leer_bytes(const char* s) {
+	// Entero no negativo; -1 si no es un número o no cabe en long long
+	if (!s || s[0] == '\0') return -1;
+	long long v = 0;
+	for (int i = 0; s[i] != '\0'; ++i) {
+		if (s[i] < '0' || s[i] > '9') return -1;
+		int d = s[i] - '0';
+		if (v > (LLONG_MAX - d) / 10) return -1;
+		v = v * 10 + d;
+	}
+	return v;
+}
+
 static Nodo* resolver_padre_para_nuevo(Nodo* raiz, Nodo* cwd, const char* ruta, char* nombreSalida, ostream& out) {
 	// Devuelve el nodo padre y llena nombreSalida con el último componente; soporta abs/rel
 	// Parsear hasta la última '/'
@@ -53,7 +78,7 @@ static Nodo* resolver_padre_para_nuevo(Nodo* raiz, Nodo* cwd, const char* ruta,
 	return padre;
 }
 
-int main() {
+int main(int argc, char** argv) {
 	// Desactivar el buffering de cout para que todo se muestre inmediatamente
 	cout << unitbuf;
 	
@@ -63,16 +88,18 @@ int main() {
 	char* archivoAbierto = nullptr; // si se establece con 'open', se guarda al salir
 	const char* rutaPorDefecto = "fs.txt"; // archivo de auto-persistencia en el directorio actual
 
+	// Presupuesto de memoria opcional en bytes: main.exe [presupuesto]
+	long long presupuesto = argc > 1 ? leer_bytes(argv[1]) : 0;
+	if (presupuesto < 0) { cerr << "Presupuesto inválido: " << argv[1] << "\n"; presupuesto = 0; }
+	// El desborde se nombra a partir de la base de persistencia
+	configurar_memoria(presupuesto, rutaPorDefecto);
+
 	// Auto-cargar archivo por defecto si existe
-	{
-		ifstream ifs(rutaPorDefecto, ios::in);
-		if (ifs.is_open()) {
-			// Redirigir errores a cerr para no interferir con cout
-			deserializar_arbol(raiz, ifs, cerr);
-			ifs.close();
-			archivoAbierto = str_duplicar(rutaPorDefecto);
-		}
+	// Redirigir errores a cerr para no interferir con cout
+	if (cargar_persistencia(raiz, rutaPorDefecto, cerr)) {
+		archivoAbierto = str_duplicar(rutaPorDefecto);
 	}
+	cwd = raiz;
 
 	// Preparar entrada
 	cin.clear();
@@ -107,13 +134,7 @@ int main() {
 		if (str_igual(cmd, "exit")) {
 			// Si hay archivo abierto, guardar allí; si no, volcar a stdout
 			if (archivoAbierto) {
-				ofstream ofs(archivoAbierto, ios::out | ios::trunc);
-				if (!ofs.is_open()) {
-					cout << "Error: no se puede guardar en '" << archivoAbierto << "'\n";
-				} else {
-					serializar_arbol(raiz, ofs);
-					ofs.close();
-				}
+				exportar_texto(raiz, archivoAbierto, cout);
 			} else {
 				serializar_arbol(raiz, cout);
 			}
@@ -175,6 +196,7 @@ int main() {
 			if (!nombre_valido(arg2)) { cout << "Nombre inválido\n"; continue; }
 			if (tiene_hijo_llamado(tgt->padre ? tgt->padre : raiz, arg2)) { cout << "Colisión de nombre\n"; continue; }
 			delete[] tgt->nombre; tgt->nombre = str_duplicar(arg2);
+			marcar_sucio(tgt->padre ? tgt->padre : raiz);
 			guardado_automatico(raiz, archivoAbierto, rutaPorDefecto);
 		} else if (str_igual(cmd, "edit")) {
 			if (arg1[0] == '\0') { cout << "Uso: edit <ruta-archivo>\n"; continue; }
@@ -184,25 +206,30 @@ int main() {
 			bool guardado = editar_archivo(f, cin, cout);
 			// Independiente de :wq o :q!, guardar para minimizar pérdidas
 			guardado_automatico(raiz, archivoAbierto, rutaPorDefecto);
+		} else if (str_igual(cmd, "mem")) {
+			// mem: estadísticas; mem <bytes>: nuevo presupuesto (0 = sin límite)
+			if (arg1[0] != '\0') {
+				long long b = leer_bytes(arg1);
+				if (b < 0) { cout << "Uso: mem [presupuesto_bytes]\n"; continue; }
+				configurar_memoria(b, nullptr);
+			}
+			imprimir_estado_memoria(cout);
 		} else if (str_igual(cmd, "load")) {
 			deserializar_arbol(raiz, cin, cout);
 		} else if (str_igual(cmd, "open")) {
 			if (arg1[0] == '\0') { cout << "Uso: open <ruta-archivo>\n"; continue; }
-			ifstream ifs(arg1, ios::in);
 			// Reiniciar árbol actual
 			liberar_arbol(raiz);
 			raiz = crear_nodo(NODO_DIR, "", nullptr);
-			cwd = raiz;
 			if (archivoAbierto) { delete[] archivoAbierto; archivoAbierto = nullptr; }
 			archivoAbierto = str_duplicar(arg1);
-			if (!ifs.is_open()) {
+			if (!cargar_persistencia(raiz, arg1, cout)) {
 				// Si no existe, iniciar árbol vacío; se creará al salir
 				cout << "Nuevo archivo: " << arg1 << "\n";
 			} else {
-				deserializar_arbol(raiz, ifs, cout);
-				ifs.close();
 				cout << "Abierto: " << arg1 << "\n";
 			}
+			cwd = raiz;
 		} else {
 			cout << "Comando desconocido: " << cmd << "\n"; //Muestra mensaje para comandos no encontrados 
 		}
@@ -213,5 +240,6 @@ int main() {
 
 	if (archivoAbierto) { delete[] archivoAbierto; }
 	liberar_arbol(raiz);
+	cerrar_memoria();
 	return 0;
 }